@@ -1,4 +1,5 @@
 #include "src/stack_blur.h"
+#include "src/stack_blur_tuner.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -8,8 +9,23 @@
 
 #include <chrono>
 #include <iostream>
+#include <string>
+
+int main(int argc, char **argv) {
+    // Autotune mode: benchmark plans on this machine and save the winners.
+    if (argc > 1 && std::string(argv[1]) == "--autotune") {
+        const char *path = argc > 2 ? argv[2] : StackBlur::DEFAULT_TUNING_FILE;
+
+        std::cout << "Autotuning..." << std::endl;
+        if (!StackBlur::autotune(path)) {
+            std::cout << "Failed to write tuning file " << path << "!" << std::endl;
+            return 1;
+        }
+        std::cout << "Tuning saved to " << path << std::endl;
+
+        return 0;
+    }
 
-int main() {
     // Load image.
     int width, height, channels;
     unsigned char *img_data = stbi_load("../res/ferris.png", &width, &height, &channels, 0);
@@ -26,6 +42,8 @@ int main() {
     // Make a copy of the image data.
     auto *img_data_copy = new unsigned char[width * height * channels];
     memcpy(img_data_copy, img_data, stride * height);
+    auto *img_data_tuned = new unsigned char[width * height * channels];
+    memcpy(img_data_tuned, img_data, stride * height);
 
     // Non SIMD.
     {
@@ -47,13 +65,30 @@ int main() {
         std::cout << "Time cost (SIMD) " << std::round(elapsed_time.count() * 10000.0f) * 0.1f << " ms" << std::endl;
     }
 
+    // Tuned plan (run the demo with --autotune first).
+    {
+        // Load the tuning file outside the timed region.
+        if (!StackBlur::load_default_tuning()) {
+            std::cout << "No tuning file for this machine, using the default plan." << std::endl;
+        }
+
+        auto start_time = std::chrono::steady_clock::now();
+
+        StackBlur::do_stack_blur_tuned(img_data_tuned, width, height, stride, 16, 16);
+
+        std::chrono::duration<double> elapsed_time = std::chrono::steady_clock::now() - start_time;
+        std::cout << "Time cost (tuned) " << std::round(elapsed_time.count() * 10000.0f) * 0.1f << " ms" << std::endl;
+    }
+
     // Save results.
     stbi_write_png("../res/ferris_blur.png", width, height, channels, img_data, stride);
     stbi_write_png("../res/ferris_blur_simd.png", width, height, channels, img_data_copy, stride);
+    stbi_write_png("../res/ferris_blur_tuned.png", width, height, channels, img_data_tuned, stride);
 
     // Clean up.
     stbi_image_free(img_data);
     delete[] img_data_copy;
+    delete[] img_data_tuned;
 
     return 0;
 }
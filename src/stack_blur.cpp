@@ -3,6 +3,10 @@
 #include "i32x4.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
 
 namespace StackBlur {
     static unsigned short const stackblur_mul[255] = {
@@ -505,4 +509,79 @@ namespace StackBlur {
             stack_blur_simd(image_data, width, height, stride, blur_y, 2, stack_buffer_i32);
         }
     }
+
+    /// Run one pass (step 1: X, step 2: Y) of the blur, splitting the image into strips among threads.
+    static void stack_blur_pass(unsigned char *image_data, unsigned int width, unsigned int height,
+                                unsigned int stride, unsigned int radius, int step, const Plan &plan) {
+        // Rows are independent in step 1, columns in step 2.
+        unsigned int lines = step == 1 ? height : width;
+        if (lines == 0) {
+            return;
+        }
+
+        unsigned int strip_width = plan.strip_width == 0 ? lines : std::min(plan.strip_width, lines);
+        unsigned int strip_count = (lines + strip_width - 1) / strip_width;
+        unsigned int thread_count = std::clamp(plan.thread_count, 1u, strip_count);
+
+        std::atomic<unsigned int> next_strip{0};
+
+        auto worker = [&]() {
+            unsigned char stack_buffer[4 * (254 * 2 + 1)] = {0};
+            I32x4 stack_buffer_i32[254 * 2 + 1];
+
+            for (unsigned int strip = next_strip++; strip < strip_count; strip = next_strip++) {
+                unsigned int first = strip * strip_width;
+                unsigned int count = std::min(strip_width, lines - first);
+
+                unsigned char *strip_data;
+                unsigned int strip_w, strip_h;
+                if (step == 1) {
+                    strip_data = image_data + first * stride;
+                    strip_w = width;
+                    strip_h = count;
+                } else {
+                    strip_data = image_data + 4 * first;
+                    strip_w = count;
+                    strip_h = height;
+                }
+
+                if (plan.kernel == Kernel::Simd) {
+                    stack_blur_simd(strip_data, strip_w, strip_h, stride, radius, step, stack_buffer_i32);
+                } else {
+                    stack_blur(strip_data, strip_w, strip_h, stride, radius, step, stack_buffer);
+                }
+            }
+        };
+
+        if (thread_count == 1) {
+            worker();
+            return;
+        }
+
+        // The calling thread works too.
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count - 1);
+        for (unsigned int i = 1; i < thread_count; i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto &thread: threads) {
+            thread.join();
+        }
+    }
+
+    void do_stack_blur_plan(unsigned char *image_data, unsigned int width, unsigned int height,
+                            unsigned int stride, unsigned int blur_x, unsigned int blur_y, const Plan &plan) {
+        if (blur_x > 0) {
+            blur_x = std::clamp(blur_x, 1u, 254u);
+
+            stack_blur_pass(image_data, width, height, stride, blur_x, 1, plan);
+        }
+
+        if (blur_y > 0) {
+            blur_y = std::clamp(blur_y, 1u, 254u);
+
+            stack_blur_pass(image_data, width, height, stride, blur_y, 2, plan);
+        }
+    }
 }
@@ -34,6 +34,33 @@ namespace StackBlur {
      */
     void do_stack_blur_simd(unsigned char *image_data, unsigned int width, unsigned int height,
                             unsigned int stride, unsigned int blur_x, unsigned int blur_y);
+
+    /// Blur kernel variants.
+    enum class Kernel {
+        Scalar,
+        Simd,
+    };
+
+    /// How a blur is executed: which kernel to use and how to split the work among threads.
+    struct Plan {
+        Kernel kernel = Kernel::Simd;
+        /// Number of rows (X pass) or columns (Y pass) a worker takes at a time, 0 for the whole image.
+        unsigned int strip_width = 64;
+        unsigned int thread_count = 1;
+    };
+
+    /**
+     * Do stack blur following an execution plan.
+     * @param src Input image data
+     * @param w Image width
+     * @param h Image height
+     * @param stride Row stride of the image data
+     * @param blur_x Blur size in X direction
+     * @param blur_y Blur size in Y direction
+     * @param plan Kernel and threading to use
+     */
+    void do_stack_blur_plan(unsigned char *image_data, unsigned int width, unsigned int height,
+                            unsigned int stride, unsigned int blur_x, unsigned int blur_y, const Plan &plan);
 }
 
 #endif //STACK_BLUR_H
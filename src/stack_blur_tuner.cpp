@@ -0,0 +1,254 @@
+#include "stack_blur_tuner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace StackBlur {
+    /// Strip widths tried for multithreaded candidates.
+    static unsigned int const strip_widths[] = {16, 64, 256};
+
+    /// Each candidate is timed this many times and the fastest run is kept.
+    static constexpr int BENCHMARK_REPEATS = 3;
+
+    static Tuning tuned;
+
+    /// Set once tuned holds loaded or freshly tuned plans, so the default file doesn't replace them.
+    static std::atomic<bool> plans_tuned{false};
+
+    static std::once_flag default_tuning_loaded;
+
+    unsigned int hardware_thread_count() {
+        return std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    static unsigned int size_bucket(unsigned int width, unsigned int height) {
+        uint64_t pixels = uint64_t(width) * height;
+
+        for (unsigned int i = 0; i < Tuning::SIZE_BUCKET_COUNT; i++) {
+            // Buckets cover up to twice their benchmarked pixel count.
+            if (pixels <= uint64_t(Tuning::SIZE_BUCKETS[i]) * Tuning::SIZE_BUCKETS[i] * 2) {
+                return i;
+            }
+        }
+
+        return Tuning::SIZE_BUCKET_COUNT - 1;
+    }
+
+    static unsigned int radius_bucket(unsigned int radius) {
+        for (unsigned int i = 0; i < Tuning::RADIUS_BUCKET_COUNT; i++) {
+            if (radius <= Tuning::RADIUS_BUCKETS[i] * 2) {
+                return i;
+            }
+        }
+
+        return Tuning::RADIUS_BUCKET_COUNT - 1;
+    }
+
+    static const char *kernel_name(Kernel kernel) {
+        return kernel == Kernel::Simd ? "simd" : "scalar";
+    }
+
+    static std::vector<Plan> candidate_plans() {
+        std::vector<unsigned int> thread_counts;
+        unsigned int hardware_threads = hardware_thread_count();
+        for (unsigned int n = 2; n < hardware_threads; n *= 2) {
+            thread_counts.push_back(n);
+        }
+        if (hardware_threads > 1) {
+            thread_counts.push_back(hardware_threads);
+        }
+
+        std::vector<Plan> plans;
+        for (auto kernel: {Kernel::Scalar, Kernel::Simd}) {
+            // A single thread processes the whole image as one strip.
+            plans.push_back({kernel, 0, 1});
+
+            for (auto thread_count: thread_counts) {
+                for (auto strip_width: strip_widths) {
+                    plans.push_back({kernel, strip_width, thread_count});
+                }
+            }
+        }
+
+        return plans;
+    }
+
+    static double benchmark_plan(const std::vector<unsigned char> &source, std::vector<unsigned char> &work,
+                                 unsigned int side, unsigned int radius, const Plan &plan) {
+        double best_time = 0;
+
+        for (int i = 0; i < BENCHMARK_REPEATS; i++) {
+            memcpy(work.data(), source.data(), source.size());
+
+            auto start_time = std::chrono::steady_clock::now();
+
+            do_stack_blur_plan(work.data(), side, side, side * 4, radius, radius, plan);
+
+            std::chrono::duration<double> elapsed_time = std::chrono::steady_clock::now() - start_time;
+            if (i == 0 || elapsed_time.count() < best_time) {
+                best_time = elapsed_time.count();
+            }
+        }
+
+        return best_time;
+    }
+
+    bool autotune(const char *path) {
+        auto candidates = candidate_plans();
+
+        for (unsigned int s = 0; s < Tuning::SIZE_BUCKET_COUNT; s++) {
+            unsigned int side = Tuning::SIZE_BUCKETS[s];
+
+            // Deterministic noise, so runs on different machines blur the same data.
+            std::vector<unsigned char> source(side * side * 4);
+            uint32_t seed = 12345;
+            for (auto &byte: source) {
+                seed = seed * 1664525u + 1013904223u;
+                byte = seed >> 24;
+            }
+            std::vector<unsigned char> work(source.size());
+
+            for (unsigned int r = 0; r < Tuning::RADIUS_BUCKET_COUNT; r++) {
+                double best_time = 0;
+
+                for (unsigned int c = 0; c < candidates.size(); c++) {
+                    double time = benchmark_plan(source, work, side, Tuning::RADIUS_BUCKETS[r], candidates[c]);
+
+                    if (c == 0 || time < best_time) {
+                        best_time = time;
+                        tuned.plans[s][r] = candidates[c];
+                    }
+                }
+            }
+        }
+
+        plans_tuned = true;
+
+        return save_tuning(path, tuned);
+    }
+
+    bool save_tuning(const char *path, const Tuning &tuning) {
+        std::ofstream file(path);
+        if (!file) {
+            return false;
+        }
+
+        // Plans only hold for the machine they were tuned on.
+        file << TUNING_FILE_MAGIC << " " << TUNING_FILE_VERSION << " " << hardware_thread_count() << "\n";
+        file << "# size radius kernel strip_width thread_count\n";
+        for (unsigned int s = 0; s < Tuning::SIZE_BUCKET_COUNT; s++) {
+            for (unsigned int r = 0; r < Tuning::RADIUS_BUCKET_COUNT; r++) {
+                const Plan &plan = tuning.plans[s][r];
+                file << Tuning::SIZE_BUCKETS[s] << " " << Tuning::RADIUS_BUCKETS[r] << " " << kernel_name(plan.kernel) << " "
+                     << plan.strip_width << " " << plan.thread_count << "\n";
+            }
+        }
+
+        return bool(file);
+    }
+
+    bool load_tuning(const char *path) {
+        std::ifstream file(path);
+        if (!file) {
+            return false;
+        }
+
+        // Reject files from another format version or another machine.
+        std::string magic;
+        unsigned int version, thread_count;
+        if (!(file >> magic >> version >> thread_count) || magic != TUNING_FILE_MAGIC ||
+            version != TUNING_FILE_VERSION || thread_count != hardware_thread_count()) {
+            return false;
+        }
+
+        // Parse into a copy, so a file without valid entries leaves the current plans alone.
+        Tuning loaded = tuned;
+        bool any_valid = false;
+
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+
+            std::istringstream fields(line);
+            unsigned int size, radius;
+            std::string kernel;
+            // Read as signed, so a negative count isn't taken for a huge one.
+            long long strip_width, threads;
+            if (!(fields >> size >> radius >> kernel >> strip_width >> threads)) {
+                continue;
+            }
+
+            Plan plan;
+            if (kernel == "simd") {
+                plan.kernel = Kernel::Simd;
+            } else if (kernel == "scalar") {
+                plan.kernel = Kernel::Scalar;
+            } else {
+                continue;
+            }
+
+            if (strip_width < 0 || strip_width > UINT32_MAX || threads < 1) {
+                continue;
+            }
+            plan.strip_width = (unsigned int) strip_width;
+            plan.thread_count = (unsigned int) std::min<long long>(threads, hardware_thread_count());
+
+            // Ignore entries for buckets this build doesn't know about.
+            auto s = std::find(std::begin(Tuning::SIZE_BUCKETS), std::end(Tuning::SIZE_BUCKETS), size);
+            auto r = std::find(std::begin(Tuning::RADIUS_BUCKETS), std::end(Tuning::RADIUS_BUCKETS), radius);
+            if (s == std::end(Tuning::SIZE_BUCKETS) || r == std::end(Tuning::RADIUS_BUCKETS)) {
+                continue;
+            }
+
+            loaded.plans[s - std::begin(Tuning::SIZE_BUCKETS)][r - std::begin(Tuning::RADIUS_BUCKETS)] = plan;
+            any_valid = true;
+        }
+
+        if (!any_valid) {
+            return false;
+        }
+
+        tuned = loaded;
+        plans_tuned = true;
+
+        return true;
+    }
+
+    bool load_default_tuning() {
+        std::call_once(default_tuning_loaded, []() {
+            if (plans_tuned) {
+                return;
+            }
+
+            const char *path = std::getenv("STACK_BLUR_TUNING_FILE");
+            load_tuning(path ? path : DEFAULT_TUNING_FILE);
+        });
+
+        return plans_tuned;
+    }
+
+    Plan select_plan(unsigned int width, unsigned int height, unsigned int radius) {
+        return tuned.plans[size_bucket(width, height)][radius_bucket(radius)];
+    }
+
+    void do_stack_blur_tuned(unsigned char *image_data, unsigned int width, unsigned int height,
+                             unsigned int stride, unsigned int blur_x, unsigned int blur_y) {
+        load_default_tuning();
+
+        auto plan = select_plan(width, height, std::max(blur_x, blur_y));
+
+        do_stack_blur_plan(image_data, width, height, stride, blur_x, blur_y, plan);
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef STACK_BLUR_TUNER_H
+#define STACK_BLUR_TUNER_H
+
+#include "stack_blur.h"
+
+namespace StackBlur {
+    /// Tuning file used by do_stack_blur_tuned() when STACK_BLUR_TUNING_FILE is not set.
+    constexpr const char *DEFAULT_TUNING_FILE = "stack_blur_tuning.txt";
+
+    /// First field of the tuning file header, followed by the format version and the hardware thread count.
+    constexpr const char *TUNING_FILE_MAGIC = "stack-blur-simd-tuning";
+    constexpr unsigned int TUNING_FILE_VERSION = 1;
+
+    /// Plans for a grid of image size/radius buckets.
+    struct Tuning {
+        /// Side lengths of the square images benchmarked for each size bucket.
+        static constexpr unsigned int SIZE_BUCKETS[] = {128, 256, 512, 1024, 2048};
+        /// Radii benchmarked for each radius bucket.
+        static constexpr unsigned int RADIUS_BUCKETS[] = {2, 8, 32, 128};
+
+        static constexpr unsigned int SIZE_BUCKET_COUNT = sizeof(SIZE_BUCKETS) / sizeof(SIZE_BUCKETS[0]);
+        static constexpr unsigned int RADIUS_BUCKET_COUNT = sizeof(RADIUS_BUCKETS) / sizeof(RADIUS_BUCKETS[0]);
+
+        Plan plans[SIZE_BUCKET_COUNT][RADIUS_BUCKET_COUNT];
+    };
+
+    /// Thread count tuning files are tagged with, at least 1.
+    unsigned int hardware_thread_count();
+
+    /**
+     * Benchmark candidate plans for a grid of image size/radius buckets on this machine,
+     * and save the fastest plan of each bucket.
+     * @param path Tuning file to write
+     * @return False if the file couldn't be written
+     */
+    bool autotune(const char *path);
+
+    /**
+     * Save plans to a tuning file for this machine.
+     * @param path Tuning file to write
+     * @param tuning Plans to save
+     * @return False if the file couldn't be written
+     */
+    bool save_tuning(const char *path, const Tuning &tuning);
+
+    /**
+     * Load a tuning file written by autotune(). Buckets missing from the file keep their current plan.
+     * Call this before blurring, it's not synchronized with select_plan().
+     * @param path Tuning file to read
+     * @return False if the file couldn't be read, was tuned on a machine with a different thread count,
+     * or has no valid entry. The current plans are kept in that case.
+     */
+    bool load_tuning(const char *path);
+
+    /**
+     * Load the tuning file named by the STACK_BLUR_TUNING_FILE environment variable, or DEFAULT_TUNING_FILE,
+     * unless plans were already loaded or tuned. Only the first call has any effect.
+     * @return True if tuned plans are in use
+     */
+    bool load_default_tuning();
+
+    /**
+     * Get the tuned plan for an image size and blur radius.
+     * @param width Image width
+     * @param height Image height
+     * @param radius Blur radius
+     */
+    Plan select_plan(unsigned int width, unsigned int height, unsigned int radius);
+
+    /**
+     * Do stack blur with the tuned plan. The first call runs load_default_tuning().
+     * @param src Input image data
+     * @param w Image width
+     * @param h Image height
+     * @param stride Row stride of the image data
+     * @param blur_x Blur size in X direction
+     * @param blur_y Blur size in Y direction
+     */
+    void do_stack_blur_tuned(unsigned char *image_data, unsigned int width, unsigned int height,
+                             unsigned int stride, unsigned int blur_x, unsigned int blur_y);
+}
+
+#endif //STACK_BLUR_TUNER_H
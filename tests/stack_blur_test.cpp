@@ -0,0 +1,350 @@
+#include "../src/stack_blur.h"
+#include "../src/stack_blur_tuner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Compares every kernel variant byte for byte against the scalar reference (do_stack_blur)
+// on fuzzed image sizes, strides and radii.
+// With --bench <results.csv> [--baseline <baseline.csv> [--update-baseline]], measures the throughput
+// of each variant instead and saves it to the results file. Variants slower than the baseline beyond
+// a tolerance fail the run; --update-baseline replaces the baseline with the new results instead.
+
+using BlurFunction = std::function<void(unsigned char *, unsigned int, unsigned int, unsigned int,
+                                        unsigned int, unsigned int)>;
+
+struct Variant {
+    std::string name;
+    BlurFunction blur;
+};
+
+struct Case {
+    unsigned int width;
+    unsigned int height;
+    unsigned int stride;
+    unsigned int blur_x;
+    unsigned int blur_y;
+};
+
+/// Deterministic generator, so failures are reproducible.
+struct Random {
+    uint32_t state;
+
+    uint32_t next() {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    }
+
+    /// Uniform in [min, max].
+    unsigned int range(unsigned int min, unsigned int max) {
+        return min + next() % (max - min + 1);
+    }
+};
+
+static std::vector<Variant> make_variants(bool with_tuned) {
+    std::vector<Variant> variants;
+
+    variants.push_back({"simd", StackBlur::do_stack_blur_simd});
+    if (with_tuned) {
+        // Runs on the fixture loaded by load_fixture().
+        variants.push_back({"tuned", StackBlur::do_stack_blur_tuned});
+    }
+
+    for (auto kernel: {StackBlur::Kernel::Scalar, StackBlur::Kernel::Simd}) {
+        for (unsigned int thread_count: {1u, 2u, 3u}) {
+            for (unsigned int strip_width: {0u, 1u, 7u, 64u}) {
+                StackBlur::Plan plan{kernel, strip_width, thread_count};
+
+                std::string name = std::string(kernel == StackBlur::Kernel::Simd ? "simd" : "scalar") +
+                                   " t" + std::to_string(thread_count) + " s" + std::to_string(strip_width);
+
+                variants.push_back({name, [plan](unsigned char *image_data, unsigned int width, unsigned int height,
+                                                  unsigned int stride, unsigned int blur_x, unsigned int blur_y) {
+                    StackBlur::do_stack_blur_plan(image_data, width, height, stride, blur_x, blur_y, plan);
+                }});
+            }
+        }
+    }
+
+    return variants;
+}
+
+static unsigned int random_side(Random &random, unsigned int radius) {
+    switch (random.range(0, 3)) {
+        case 0:
+            return 1;
+        case 1:
+            // Smaller than the radius.
+            return random.range(1, std::max(radius, 2u) - 1);
+        default:
+            return random.range(1, 200);
+    }
+}
+
+static bool write_file(const std::string &path, const std::string &content) {
+    std::ofstream file(path);
+    file << content;
+    return bool(file);
+}
+
+/// Load a fixture with a mix of kernels, strip widths and thread counts for the "tuned" variant.
+static bool load_fixture() {
+    const char *env_path = std::getenv("STACK_BLUR_TUNING_FILE");
+    std::string path = env_path ? env_path : "stack_blur_test_tuning.txt";
+
+    StackBlur::Tuning tuning;
+    unsigned int entry = 0;
+    for (auto &row: tuning.plans) {
+        for (auto &plan: row) {
+            plan.kernel = entry % 2 ? StackBlur::Kernel::Simd : StackBlur::Kernel::Scalar;
+            plan.strip_width = entry % 3 == 0 ? 0 : entry % 3 == 1 ? 1 : 7;
+            plan.thread_count = entry % 3 + 1;
+            entry++;
+        }
+    }
+
+    if (!StackBlur::save_tuning(path.c_str(), tuning) || !StackBlur::load_tuning(path.c_str())) {
+        std::cout << "FAIL tuned: couldn't save and load the fixture " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static std::vector<Case> make_cases() {
+    std::vector<Case> cases;
+
+    // Edge cases: single pixels, single rows/columns, extreme radii.
+    for (unsigned int radius: {1u, 2u, 254u}) {
+        cases.push_back({1, 1, 4, radius, radius});
+        cases.push_back({1, 37, 4, radius, radius});
+        cases.push_back({37, 1, 37 * 4, radius, radius});
+        cases.push_back({5, 300, 5 * 4 + 12, radius, 0});
+        cases.push_back({300, 5, 300 * 4 + 3, 0, radius});
+    }
+
+    Random random{2024};
+    for (int i = 0; i < 400; i++) {
+        Case c{};
+        c.blur_x = random.range(0, 9) == 0 ? 0 : random.range(1, 254);
+        c.blur_y = random.range(0, 9) == 0 ? 0 : random.range(1, 254);
+        c.width = random_side(random, c.blur_x);
+        c.height = random_side(random, c.blur_y);
+        // Padding doesn't have to be a whole pixel.
+        c.stride = c.width * 4 + (random.range(0, 1) ? random.range(1, 13) : 0);
+        cases.push_back(c);
+    }
+
+    return cases;
+}
+
+static std::string describe(const Case &c) {
+    return std::to_string(c.width) + "x" + std::to_string(c.height) + " stride " + std::to_string(c.stride) +
+           " blur " + std::to_string(c.blur_x) + "/" + std::to_string(c.blur_y);
+}
+
+static bool check_exactness(const std::vector<Variant> &variants) {
+    auto cases = make_cases();
+    Random random{7};
+    int failures = 0;
+
+    for (const auto &c: cases) {
+        std::vector<unsigned char> source(c.stride * c.height);
+        for (auto &byte: source) {
+            byte = random.next();
+        }
+
+        auto expected = source;
+        StackBlur::do_stack_blur(expected.data(), c.width, c.height, c.stride, c.blur_x, c.blur_y);
+
+        // The reference must leave row padding alone.
+        for (unsigned int y = 0; y < c.height; y++) {
+            unsigned int row = y * c.stride;
+            if (memcmp(expected.data() + row + c.width * 4, source.data() + row + c.width * 4,
+                       c.stride - c.width * 4) != 0) {
+                std::cout << "FAIL reference: padding written, " << describe(c) << std::endl;
+                failures++;
+                break;
+            }
+        }
+
+        for (const auto &variant: variants) {
+            auto actual = source;
+            variant.blur(actual.data(), c.width, c.height, c.stride, c.blur_x, c.blur_y);
+
+            if (actual == expected) {
+                continue;
+            }
+
+            size_t offset = 0;
+            while (actual[offset] == expected[offset]) {
+                offset++;
+            }
+
+            std::cout << "FAIL " << variant.name << ": " << describe(c) << ", first difference at byte " << offset
+                      << " (row " << offset / c.stride << ", column " << offset % c.stride / 4 << ", channel "
+                      << offset % c.stride % 4 << "): expected " << int(expected[offset]) << ", got "
+                      << int(actual[offset]) << std::endl;
+            failures++;
+        }
+    }
+
+    std::cout << cases.size() << " cases x " << variants.size() << " variants, " << failures << " failures"
+              << std::endl;
+
+    return failures == 0;
+}
+
+/// Load benchmark results, keyed by "<variant>,<radius>".
+static std::map<std::string, double> load_benchmark(const std::string &path) {
+    std::map<std::string, double> results;
+
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        auto comma = line.rfind(',');
+        if (comma == std::string::npos || line.rfind("variant,", 0) == 0) {
+            continue;
+        }
+        results[line.substr(0, comma)] = std::atof(line.c_str() + comma + 1);
+    }
+
+    return results;
+}
+
+static bool run_benchmark(const std::vector<Variant> &variants, const std::string &results_path,
+                          const std::string &baseline_path, bool update_baseline) {
+    // A variant is a regression below this fraction of its baseline throughput.
+    const double tolerance = 0.75;
+
+    const unsigned int side = 1024;
+    const unsigned int stride = side * 4;
+
+    std::map<std::string, double> baseline;
+    if (!baseline_path.empty() && !update_baseline) {
+        baseline = load_benchmark(baseline_path);
+        if (baseline.empty()) {
+            std::cout << "No baseline in " << baseline_path << ", create it with --update-baseline" << std::endl;
+        }
+    }
+    std::ostringstream csv;
+    csv << "variant,radius,mpix_per_second\n";
+    int regressions = 0;
+
+    std::vector<unsigned char> source(stride * side);
+    Random random{99};
+    for (auto &byte: source) {
+        byte = random.next();
+    }
+    std::vector<unsigned char> work(source.size());
+
+    std::vector<Variant> all = {{"scalar (reference)", StackBlur::do_stack_blur}};
+    all.insert(all.end(), variants.begin(), variants.end());
+
+    for (unsigned int radius: {4u, 32u, 128u}) {
+        std::cout << "Throughput, " << side << "x" << side << ", radius " << radius << ":" << std::endl;
+
+        for (const auto &variant: all) {
+            double best_time = 0;
+
+            for (int i = 0; i < 3; i++) {
+                memcpy(work.data(), source.data(), source.size());
+
+                auto start_time = std::chrono::steady_clock::now();
+
+                variant.blur(work.data(), side, side, stride, radius, radius);
+
+                std::chrono::duration<double> elapsed_time = std::chrono::steady_clock::now() - start_time;
+                if (i == 0 || elapsed_time.count() < best_time) {
+                    best_time = elapsed_time.count();
+                }
+            }
+
+            double mpix_per_second = double(side) * side / best_time / 1e6;
+            std::cout << "  " << std::left << std::setw(20) << variant.name << std::right << std::fixed
+                      << std::setprecision(1) << std::setw(8) << mpix_per_second << " Mpix/s";
+
+            std::string key = variant.name + "," + std::to_string(radius);
+            auto previous = baseline.find(key);
+            if (previous != baseline.end()) {
+                std::cout << " (baseline " << previous->second << ")";
+                if (mpix_per_second < previous->second * tolerance) {
+                    std::cout << " REGRESSION";
+                    regressions++;
+                }
+            }
+            std::cout << std::endl;
+
+            csv << key << "," << mpix_per_second << "\n";
+        }
+    }
+
+    if (!write_file(results_path, csv.str())) {
+        std::cout << "FAIL couldn't write " << results_path << std::endl;
+        return false;
+    }
+    std::cout << "Results saved to " << results_path << std::endl;
+
+    if (update_baseline) {
+        if (!write_file(baseline_path, csv.str())) {
+            std::cout << "FAIL couldn't write " << baseline_path << std::endl;
+            return false;
+        }
+        std::cout << "Baseline updated: " << baseline_path << std::endl;
+    }
+
+    if (regressions > 0) {
+        std::cout << "FAIL " << regressions << " variants below " << int(tolerance * 100)
+                  << "% of their baseline throughput" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        std::string results_path, baseline_path;
+        bool update_baseline = false;
+
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--bench" && i + 1 < argc) {
+                results_path = argv[++i];
+            } else if (arg == "--baseline" && i + 1 < argc) {
+                baseline_path = argv[++i];
+            } else if (arg == "--update-baseline") {
+                update_baseline = true;
+            } else {
+                results_path.clear();
+                break;
+            }
+        }
+
+        if (results_path.empty() || (update_baseline && baseline_path.empty())) {
+            std::cout << "Usage: stack_blur_test [--bench <results.csv> [--baseline <baseline.csv> "
+                         "[--update-baseline]]]" << std::endl;
+            return 2;
+        }
+
+        // The tuned variant is left out, its throughput would depend on whichever plans get loaded.
+        return run_benchmark(make_variants(false), results_path, baseline_path, update_baseline) ? 0 : 1;
+    }
+
+    bool passed = load_fixture();
+
+    passed &= check_exactness(make_variants(true));
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+#include "../src/stack_blur_tuner.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Checks how tuning files are validated, saved and loaded.
+// When STACK_BLUR_TUNING_FILE is set, a decoy file written there must not replace explicitly loaded plans.
+
+static const char *const scratch_path = "stack_blur_tuner_test_scratch.txt";
+static const char *const saved_path = "stack_blur_tuner_test_saved.txt";
+
+static int failures = 0;
+
+static void expect(bool condition, const std::string &message) {
+    if (!condition) {
+        std::cout << "FAIL " << message << std::endl;
+        failures++;
+    }
+}
+
+static void write_file(const std::string &path, const std::string &content) {
+    std::ofstream file(path);
+    file << content;
+}
+
+static std::string header(unsigned int version, unsigned int thread_count) {
+    return std::string(StackBlur::TUNING_FILE_MAGIC) + " " + std::to_string(version) + " " +
+           std::to_string(thread_count) + "\n";
+}
+
+static bool same_plan(const StackBlur::Plan &a, const StackBlur::Plan &b) {
+    return a.kernel == b.kernel && a.strip_width == b.strip_width && a.thread_count == b.thread_count;
+}
+
+/// A different plan for every bucket, offset by seed.
+static StackBlur::Tuning make_tuning(unsigned int seed) {
+    StackBlur::Tuning tuning;
+    unsigned int entry = seed;
+
+    for (auto &row: tuning.plans) {
+        for (auto &plan: row) {
+            plan.kernel = entry % 2 ? StackBlur::Kernel::Simd : StackBlur::Kernel::Scalar;
+            plan.strip_width = entry % 5 * 3;
+            plan.thread_count = std::min(entry % 3 + 1, StackBlur::hardware_thread_count());
+            entry++;
+        }
+    }
+
+    return tuning;
+}
+
+static void expect_selected(const StackBlur::Tuning &tuning, const std::string &what) {
+    for (unsigned int s = 0; s < StackBlur::Tuning::SIZE_BUCKET_COUNT; s++) {
+        for (unsigned int r = 0; r < StackBlur::Tuning::RADIUS_BUCKET_COUNT; r++) {
+            unsigned int side = StackBlur::Tuning::SIZE_BUCKETS[s];
+            unsigned int radius = StackBlur::Tuning::RADIUS_BUCKETS[r];
+
+            expect(same_plan(StackBlur::select_plan(side, side, radius), tuning.plans[s][r]),
+                   what + ": wrong plan for " + std::to_string(side) + "x" + std::to_string(side) + " radius " +
+                   std::to_string(radius));
+        }
+    }
+}
+
+int main() {
+    unsigned int thread_count = StackBlur::hardware_thread_count();
+    std::string entry = std::to_string(StackBlur::Tuning::SIZE_BUCKETS[0]) + " " +
+                        std::to_string(StackBlur::Tuning::RADIUS_BUCKETS[0]) + " ";
+
+    expect(!StackBlur::load_tuning("stack_blur_tuner_test_missing.txt"), "accepted a missing file");
+
+    write_file(scratch_path, header(StackBlur::TUNING_FILE_VERSION, thread_count + 1) + entry + "scalar 7 1\n");
+    expect(!StackBlur::load_tuning(scratch_path), "accepted a file from another machine");
+
+    write_file(scratch_path, header(StackBlur::TUNING_FILE_VERSION + 1, thread_count) + entry + "scalar 7 1\n");
+    expect(!StackBlur::load_tuning(scratch_path), "accepted a file from another format version");
+
+    write_file(scratch_path, entry + "scalar 7 1\n");
+    expect(!StackBlur::load_tuning(scratch_path), "accepted a file without header");
+
+    write_file(scratch_path, header(StackBlur::TUNING_FILE_VERSION, thread_count) +
+                             entry + "simd 1 -1\n" +
+                             entry + "simd -1 1\n" +
+                             entry + "simd 1 0\n" +
+                             entry + "avx 0 1\n" +
+                             entry + "simd\n" +
+                             "100 3 simd 0 1\n");
+    expect(!StackBlur::load_tuning(scratch_path), "accepted a file without valid entries");
+
+    // Rejected files leave the current plans alone.
+    expect_selected(StackBlur::Tuning(), "after rejected files");
+
+    write_file(scratch_path, header(StackBlur::TUNING_FILE_VERSION, thread_count) + entry + "simd 0 100000\n");
+    expect(StackBlur::load_tuning(scratch_path), "rejected a valid file");
+    expect(StackBlur::select_plan(StackBlur::Tuning::SIZE_BUCKETS[0], StackBlur::Tuning::SIZE_BUCKETS[0],
+                                  StackBlur::Tuning::RADIUS_BUCKETS[0]).thread_count == thread_count,
+           "thread count not clamped to the hardware thread count");
+
+    // Round trip through save_tuning().
+    auto tuning = make_tuning(0);
+    expect(StackBlur::save_tuning(saved_path, tuning), "couldn't save tuning");
+    expect(StackBlur::load_tuning(saved_path), "rejected a saved tuning");
+    expect_selected(tuning, "after loading a saved tuning");
+
+    // Explicitly loaded plans win over the default tuning file.
+    const char *default_path = std::getenv("STACK_BLUR_TUNING_FILE");
+    if (default_path) {
+        StackBlur::save_tuning(default_path, make_tuning(1));
+        expect(StackBlur::load_default_tuning(), "no tuned plans in use");
+        expect_selected(tuning, "after loading the default tuning");
+        std::remove(default_path);
+    }
+
+    std::remove(scratch_path);
+    std::remove(saved_path);
+
+    std::cout << failures << " failures" << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}